@@ -0,0 +1,145 @@
+// Batch rendering of per event plots, sharded over worker processes with canvases and graphs reused within each worker
+// Usage example - see plotMWDAnalysis in Plotting/plotMWDAnalysis.C
+//   renderBatch("plotMWDAnalysis", plotKeys.size(), nWorkers, [&](unsigned int i, PlotCache &cache) { return plot(..., cache); });
+
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <ROOT/TProcessExecutor.hxx>
+#include <ROOT/TSeq.hxx>
+#include <TCanvas.h>
+#include <TError.h>
+#include <TGraph.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+class PlotCache {
+    /*
+        Description
+            Canvases and graphs owned by one rendering process and reused for every plot it generates, so memory use does not grow with the number of plots. Canvases are identified by name and size, graphs by name
+
+        Variables
+            canvases - canvases by name and size
+            graphs - graphs by name
+    */
+    public:
+        PlotCache() {};
+        PlotCache(const PlotCache&) = delete;
+        PlotCache &operator=(const PlotCache&) = delete;
+        ~PlotCache() {
+            for (std::pair<const std::string, TGraph*> &graph : graphs)
+                delete graph.second;
+            for (std::pair<const std::string, TCanvas*> &canvas : canvases)
+                delete canvas.second;
+        };
+
+        TCanvas *canvas(const std::string &name, const int px, const int py) {
+            /*
+                Description
+                    Returns the cleared canvas with the given name and size, creating it on first use, and makes it the current pad
+            */
+            const std::string key = name + "." + std::to_string(px) + "x" + std::to_string(py);
+            TCanvas *&c = canvases[key];
+            if (c == nullptr)
+                c = new TCanvas(key.c_str(), name.c_str(), px, py);
+            c->cd();
+            c->Clear();
+            return c;
+        };
+
+        TGraph *graph(const std::string &name, const int n, const double *x, const double *y) {
+            /*
+                Description
+                    Returns the graph with the given name filled with the n points (x, y), creating it on first use. The axis ranges of a reused graph are recomputed from the new points, other attributes are kept and should be set by the caller
+            */
+            TGraph *&g = graphs[name];
+            if (g == nullptr) {
+                g = new TGraph(n, x, y);
+                g->SetName(name.c_str());
+                return g;
+            };
+            g->Set(n);
+            for (int i = 0; i < n; i++)
+                g->SetPoint(i, x[i], y[i]);
+            return g;
+        };
+
+    private:
+        std::map<std::string, TCanvas*> canvases;
+        std::map<std::string, TGraph*> graphs;
+};
+
+template <typename F>
+void renderBatch(const std::string &name, const unsigned int nItems, const unsigned int nWorkers, F renderItem) {
+    /*
+        Description
+            Renders nItems items, e.g. events or waveforms, calling renderItem(item, cache) for each. renderItem returns the number of plots it saved
+            The items are split into nWorkers contiguous shards, each rendered by its own forked process as ROOT graphics are not thread safe. With one worker the items are rendered in this process. Each worker reports its progress and the time taken by each item, and a summary of the per plot timing is printed at the end
+
+        Arguments
+            name - name used in the progress messages
+            nItems - number of items to render
+            nWorkers - number of worker processes
+            renderItem - renders a single item
+
+        Variables
+            workers - number of workers used
+            worker - renders a shard, returning (time [ms], number of plots) for each item
+            start - start time of the batch
+            results - per item timing of each worker
+            wallTime - time taken by the batch [s]
+            nPlots - number of plots saved
+            itemTime - summed time taken by the items [ms]
+            maxItemTime - longest time taken by an item [ms]
+    */
+    if (nItems == 0)
+        return;
+    const unsigned int workers = std::max(1u, std::min(nWorkers, nItems));
+    auto worker = [&](unsigned int w) {
+        PlotCache cache;
+        const unsigned int first = (unsigned long)nItems * w / workers, last = (unsigned long)nItems * (w + 1) / workers;
+        std::vector<double> timing;
+        for (unsigned int i = first; i < last; i++) {
+            const std::chrono::steady_clock::time_point itemStart = std::chrono::steady_clock::now();
+            const int plots = renderItem(i, cache);
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - itemStart).count();
+            timing.push_back(ms);
+            timing.push_back(plots);
+            std::cout << name << " [worker " << w << "] " << i - first + 1 << "/" << last - first << ", " << plots << " plots in " << ms << " ms" << std::endl;
+        };
+        return timing;
+    };
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::vector<double>> results;
+    if (workers == 1)
+        results.push_back(worker(0));
+    else {
+        std::cout << name << " rendering " << nItems << " items with " << workers << " worker processes" << std::endl;
+        ROOT::TProcessExecutor pool(workers);
+        results = pool.Map(worker, ROOT::TSeqU(workers));
+    };
+    const double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Summarize the timing
+    long nPlots = 0;
+    double itemTime = 0.0, maxItemTime = 0.0;
+    for (const std::vector<double> &timing : results) {
+        for (size_t i = 0; i + 1 < timing.size(); i += 2) {
+            itemTime += timing[i];
+            maxItemTime = std::max(maxItemTime, timing[i]);
+            nPlots += timing[i + 1];
+        };
+    };
+    std::cout << name << " rendered " << nPlots << " plots from " << nItems << " items in " << wallTime << " s with " << workers << " workers, "
+              << itemTime / nItems << " ms per item (max " << maxItemTime << " ms), "
+              << (nPlots > 0 ? itemTime / nPlots : 0) << " ms per plot, "
+              << nPlots / wallTime << " plots/s" << std::endl;
+    return;
+};
+
+#endif
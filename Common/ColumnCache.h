@@ -0,0 +1,256 @@
+// Memory mapped cache of columns extracted from flat TTrees, stored in a cache directory and used by ColumnReader
+// Usage example - see ColumnReader::read in Common/ColumnReader.h
+//   ColumnCache cache(getColumnCacheDirectory(), fileName, treeName);
+//   std::unique_ptr<MappedColumn> column = cache.open("E", kDouble_t, sizeof(double));
+//   const double *energies = column->values<double>();
+
+#ifndef COLUMNCACHE_H
+#define COLUMNCACHE_H
+
+#include <RtypesCore.h>
+#include <TDataType.h>
+#include <TError.h>
+#include <TFile.h>
+#include <TUUID.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <typeinfo>
+#include <unistd.h>
+#include <vector>
+
+struct ColumnCacheHeader {
+    /*
+        Description
+            Header at the start of every cache file. The column data follows at dataOffset as entries contiguous values of the column type
+
+        Variables
+            magic - format tag, "STMCOL"
+            version - format version
+            type - ROOT data type of the column
+            elementSize - size of one value in bytes
+            entries - number of values
+            sourceSize - size of the ROOT file the column was extracted from, in bytes
+            sourceModified - modification time of the ROOT file the column was extracted from
+            dataOffset - position of the first value in the cache file, aligned to 64 bytes
+            uuid - UUID of the ROOT file the column was extracted from, see TFile::GetUUID
+            treeName - name of the tree the column was extracted from
+            branchName - name of the branch the column was extracted from
+    */
+    char magic[8];
+    Int_t version, type, elementSize, reserved;
+    Long64_t entries, sourceSize, sourceModified, dataOffset;
+    char uuid[40];
+    char treeName[192];
+    char branchName[192];
+};
+
+class MappedColumn {
+    /*
+        Description
+            Read only memory mapping of a cache file. The values returned by function "values" point into the mapping and are valid for as long as the mapping exists. ColumnReader copies them into its output columns instead
+
+        Variables
+            mapping - start of the mapped file
+            size - size of the mapped file, in bytes
+    */
+    public:
+        MappedColumn(void *mapping, const size_t size) : mapping(mapping), size(size) {};
+        ~MappedColumn() { munmap(mapping, size); };
+        MappedColumn(const MappedColumn&) = delete;
+        MappedColumn &operator=(const MappedColumn&) = delete;
+
+        const ColumnCacheHeader &header() const { return *static_cast<const ColumnCacheHeader*>(mapping); };
+        Long64_t entries() const { return header().entries; };
+        const void *data() const { return static_cast<const char*>(mapping) + header().dataOffset; };
+
+        template <typename T>
+        const T *values() const {
+            if (header().type != TDataType::GetType(typeid(T)))
+                Fatal("MappedColumn::values", "Requested type does not match the type of the cached column.");
+            return static_cast<const T*>(data());
+        };
+
+    private:
+        void *mapping;
+        const size_t size;
+};
+
+inline std::string getColumnCacheDirectory() {
+    /*
+        Description
+            Returns the column cache directory set with the STM_COLUMN_CACHE environment variable, e.g. $ export STM_COLUMN_CACHE=/scratch/$USER/columnCache
+            The column cache is opt in, an empty string is returned if the variable is not set, which disables the cache
+    */
+    const char *directory = std::getenv("STM_COLUMN_CACHE");
+    return directory == nullptr ? "" : directory;
+};
+
+class ColumnCache {
+    /*
+        Description
+            Locates, validates, and writes the cached columns of one tree in one ROOT file. Each column is stored in cacheDirectory as
+                <absolute fileName with '/' replaced by '_'>.<treeName with '/' replaced by '_'>.<branchName>.column
+            A cached column is used while the size and modification time of the ROOT file are unchanged. If only the modification time changed, e.g. after copying the file, the UUID written in the ROOT file header decides, and on a match the modification time in the cache header is updated so the file is not opened again on the next run. Otherwise the column is rebuilt by the caller
+            Cache files are written to a temporary file and renamed, so concurrent readers never see a partially written cache file
+
+        Variables
+            fileName - ROOT file name as a relative path to cwd
+            treeName - name of the tree
+            fileTag - absolute path of the ROOT file, so that files with the same name in different directories do not share cache files
+            treeTag - name of the tree, usable in a file name
+            prefix - path of the cache files without the branch name
+            sourceSize - size of the ROOT file, in bytes
+            sourceModified - modification time of the ROOT file
+            uuid - UUID of the ROOT file, read when first needed
+            dataOffset - position of the first value in every cache file
+    */
+    public:
+        ColumnCache(const std::string &cacheDirectory, const std::string &fileName, const std::string &treeName) : fileName(fileName), treeName(treeName) {
+            char *absolute = realpath(fileName.c_str(), nullptr);
+            std::string fileTag = absolute == nullptr ? fileName : absolute, treeTag = treeName;
+            free(absolute);
+            std::replace(fileTag.begin(), fileTag.end(), '/', '_');
+            std::replace(treeTag.begin(), treeTag.end(), '/', '_');
+            prefix = cacheDirectory + "/" + fileTag + "." + treeTag + ".";
+            struct stat sourceStat;
+            if (stat(fileName.c_str(), &sourceStat) == 0) {
+                sourceSize = sourceStat.st_size;
+                sourceModified = sourceStat.st_mtime;
+            };
+        };
+
+        std::string path(const std::string &branchName) const { return prefix + branchName + ".column"; };
+
+        std::unique_ptr<MappedColumn> open(const std::string &branchName, const EDataType type, const Int_t elementSize) {
+            /*
+                Description
+                    Maps the cached column of branchName. Returns nullptr if there is no valid cached column with the requested type
+
+                Variables
+                    descriptor - file descriptor of the cache file
+                    cacheStat - status of the cache file
+                    mapping - start of the mapped file
+                    column - mapped column
+                    header - header of the cache file
+            */
+            if (sourceSize < 0)
+                return nullptr;
+            const int descriptor = ::open(path(branchName).c_str(), O_RDONLY);
+            if (descriptor < 0)
+                return nullptr;
+            struct stat cacheStat;
+            if (fstat(descriptor, &cacheStat) != 0 || cacheStat.st_size < (off_t)dataOffset) {
+                close(descriptor);
+                return nullptr;
+            };
+            void *mapping = mmap(nullptr, cacheStat.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+            close(descriptor);
+            if (mapping == MAP_FAILED)
+                return nullptr;
+            std::unique_ptr<MappedColumn> column = std::make_unique<MappedColumn>(mapping, cacheStat.st_size);
+
+            // Validate the schema, the size, and the source of the cached column
+            const ColumnCacheHeader &header = column->header();
+            if (std::strncmp(header.magic, "STMCOL", 8) != 0 || header.version != 2 || header.type != type || header.elementSize != elementSize || header.dataOffset != dataOffset)
+                return nullptr;
+            if (treeName != std::string(header.treeName, strnlen(header.treeName, sizeof(header.treeName))) || branchName != std::string(header.branchName, strnlen(header.branchName, sizeof(header.branchName))))
+                return nullptr;
+            if (header.entries < 0 || cacheStat.st_size != (off_t)(dataOffset + header.entries * elementSize))
+                return nullptr;
+            if (header.sourceSize != sourceSize)
+                return nullptr;
+            if (header.sourceModified != sourceModified) {
+                if (getUUID().empty() || std::string(header.uuid, strnlen(header.uuid, sizeof(header.uuid))) != getUUID())
+                    return nullptr;
+                refresh(branchName);
+            };
+            return column;
+        };
+
+        void write(const std::string &branchName, const EDataType type, const Int_t elementSize, const void *data, const Long64_t entries) {
+            /*
+                Description
+                    Writes the column of branchName. If the cache file cannot be written, e.g. in a read only directory, the column is read from the ROOT file on the next run
+
+                Variables
+                    header - header of the cache file
+                    temporaryPath - path the cache file is written to before being renamed
+                    cacheFile - cache file stream
+            */
+            if (sourceSize < 0 || treeName.size() >= sizeof(ColumnCacheHeader::treeName) || branchName.size() >= sizeof(ColumnCacheHeader::branchName))
+                return;
+            ColumnCacheHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::strncpy(header.magic, "STMCOL", sizeof(header.magic));
+            header.version = 2;
+            header.type = type;
+            header.elementSize = elementSize;
+            header.entries = entries;
+            header.sourceSize = sourceSize;
+            header.sourceModified = sourceModified;
+            header.dataOffset = dataOffset;
+            std::strncpy(header.uuid, getUUID().c_str(), sizeof(header.uuid) - 1);
+            std::strncpy(header.treeName, treeName.c_str(), sizeof(header.treeName) - 1);
+            std::strncpy(header.branchName, branchName.c_str(), sizeof(header.branchName) - 1);
+
+            const std::string temporaryPath = path(branchName) + ".tmp" + std::to_string(getpid()) + "." + std::to_string(std::hash<const void*>()(data));
+            std::ofstream cacheFile(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!cacheFile.is_open()) {
+                std::cout << "Could not write column cache " << path(branchName) << ", it will be read from the ROOT file on the next run" << std::endl;
+                return;
+            };
+            const std::vector<char> padding(dataOffset - sizeof(header), 0);
+            cacheFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            cacheFile.write(padding.data(), padding.size());
+            cacheFile.write(static_cast<const char*>(data), entries * elementSize);
+            cacheFile.close();
+            if (!cacheFile || std::rename(temporaryPath.c_str(), path(branchName).c_str()) != 0) {
+                std::remove(temporaryPath.c_str());
+                std::cout << "Could not write column cache " << path(branchName) << ", it will be read from the ROOT file on the next run" << std::endl;
+            };
+            return;
+        };
+
+    private:
+        const std::string &getUUID() {
+            // Only the header of the ROOT file is read, the UUID is empty if the file cannot be opened
+            if (!uuidRead) {
+                std::unique_ptr<TFile> file(TFile::Open(fileName.c_str(), "READ"));
+                if (file && !file->IsZombie())
+                    uuid = file->GetUUID().AsString();
+                uuidRead = true;
+            };
+            return uuid;
+        };
+
+        void refresh(const std::string &branchName) const {
+            // Update the modification time in the header of a validated cache file, failures are ignored as the UUID is checked again on the next run
+            const int descriptor = ::open(path(branchName).c_str(), O_WRONLY);
+            if (descriptor < 0)
+                return;
+            if (pwrite(descriptor, &sourceModified, sizeof(sourceModified), offsetof(ColumnCacheHeader, sourceModified)) != sizeof(sourceModified))
+                std::cout << "Could not update column cache " << path(branchName) << std::endl;
+            close(descriptor);
+            return;
+        };
+
+        const std::string fileName, treeName;
+        std::string prefix, uuid;
+        bool uuidRead = false;
+        Long64_t sourceSize = -1, sourceModified = 0;
+        static constexpr Long64_t dataOffset = 512;
+        static_assert(sizeof(ColumnCacheHeader) <= dataOffset, "The column cache header must fit before the data");
+};
+
+#endif
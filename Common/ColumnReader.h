@@ -0,0 +1,431 @@
+// Shared multithreaded columnar reader for flat TTrees, used by the macros in place of per-macro entry by entry readers
+// Usage example - see collectData in Plotting/plotMWDResults.C
+//   ColumnReader reader(fileNames, treeName);
+//   reader.addColumn("E", energies);
+//   reader.read();
+
+#ifndef COLUMNREADER_H
+#define COLUMNREADER_H
+
+#include "ColumnCache.h"
+#include <ROOT/TSeq.hxx>
+#include <ROOT/TThreadExecutor.hxx>
+#include <TBranch.h>
+#include <TBufferFile.h>
+#include <TDataType.h>
+#include <TError.h>
+#include <TFile.h>
+#include <TLeaf.h>
+#include <TROOT.h>
+#include <TSystem.h>
+#include <TTree.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+struct EntryRange {
+    /*
+        Description
+            Range of entries [first, last) in a tree
+    */
+    Long64_t first, last;
+};
+
+class ColumnBase {
+    /*
+        Description
+            Type erased interface to a column requested from ColumnReader
+
+        Variables
+            branchName - name of the branch the column is read from
+    */
+    public:
+        ColumnBase(const std::string &branchName) : branchName(branchName) {};
+        virtual ~ColumnBase() {};
+        virtual EDataType type() const = 0;
+        virtual void resize(const Long64_t entries) = 0;
+        virtual void read(TBranch *branch, const Long64_t offset, const Long64_t first, const Long64_t last) = 0;
+        virtual Int_t elementSize() const = 0;
+        virtual void copy(const void *data, const Long64_t offset, const Long64_t first, const Long64_t last) = 0;
+        virtual const void *slice(const Long64_t offset) const = 0;
+        const std::string branchName;
+};
+
+template <typename T>
+class Column : public ColumnBase {
+    /*
+        Description
+            Column of type T read into a user owned vector. Each file is read into its own slice of the vector, so files can be read in parallel without locking
+
+        Variables
+            values - user owned output column
+    */
+    public:
+        Column(const std::string &branchName, std::vector<T> &values) : ColumnBase(branchName), values(values) {};
+        EDataType type() const override { return TDataType::GetType(typeid(T)); };
+        void resize(const Long64_t entries) override { values.resize(entries); };
+        void read(TBranch *branch, const Long64_t offset, const Long64_t first, const Long64_t last) override {
+            // Read the entry range [first, last) of a single branch into the slice starting at offset. Scalar branches are read basket by basket with the bulk API, which deserializes a whole basket into buffer at once, and any remaining entries are read entry by entry, e.g. if the branch does not support bulk reads
+            T *out = values.data() + offset;
+            Long64_t entry = first;
+            if (branch->SupportsBulkRead()) {
+                TLeaf *leaf = (TLeaf*)branch->GetListOfLeaves()->At(0);
+                if (leaf->GetLeafCount() == nullptr && leaf->GetLenStatic() == 1) {
+                    TBufferFile buffer(TBuffer::kWrite, 32 * 1024);
+                    Int_t nRead = 0;
+                    Long64_t basketFirst = 0, n = 0;
+                    while (entry < last && (nRead = branch->GetBulkRead().GetBulkEntries(entry, buffer)) > 0) {
+                        // The buffer holds the whole basket containing entry, starting at the first entry of the basket
+                        basketFirst = branch->GetBasketEntry()[branch->GetReadBasket()];
+                        n = std::min(basketFirst + nRead, last) - entry;
+                        std::memcpy(out + entry - first, reinterpret_cast<const T*>(buffer.GetCurrent()) + entry - basketFirst, n * sizeof(T));
+                        entry += n;
+                    };
+                };
+            };
+            if (entry < last) {
+                T value;
+                branch->SetAddress(&value);
+                for (; entry < last; entry++) {
+                    branch->GetEntry(entry);
+                    out[entry - first] = value;
+                };
+                branch->ResetAddress();
+            };
+            return;
+        };
+        Int_t elementSize() const override { return sizeof(T); };
+        void copy(const void *data, const Long64_t offset, const Long64_t first, const Long64_t last) override {
+            // Copy the entry range [first, last) of a mapped cached column into the slice starting at offset, as a single memcpy
+            std::memcpy(values.data() + offset, static_cast<const T*>(data) + first, (last - first) * sizeof(T));
+            return;
+        };
+        const void *slice(const Long64_t offset) const override { return values.data() + offset; };
+
+    private:
+        std::vector<T> &values;
+};
+
+class ColumnReader {
+    /*
+        Description
+            Reads a set of typed columns from the same flat TTree in a list of files. The schema and entry counts are checked once for all files, the output columns are sized once, and the files are then read in parallel, each thread reading its file cluster by cluster and branch by branch through a TTreeCache restricted to the requested branches. Within a cluster, scalar branches are read a basket at a time with the ROOT bulk API rather than entry by entry
+            If a column cache directory is given, the extracted columns of each file are stored there in a memory mapped cache, see Common/ColumnCache.h. If all the requested columns of a file are cached and the file is unchanged, they are copied from the cache with one memcpy per column instead of reading the ROOT file. The output vectors are always owned by the caller, so this is a copy rather than a zero copy view of the mapping, see MappedColumn in Common/ColumnCache.h for direct access. The cache is disabled by default and enabled for all macros by setting the STM_COLUMN_CACHE environment variable, see function "getColumnCacheDirectory"
+
+        Variables
+            fileNames - ROOT file names as a relative path to cwd
+            treeName - name of the tree in every file
+            cacheSize - size of the TTreeCache used for each file, in bytes
+            columnCacheDirectory - directory of the column cache, created if it does not exist. The column cache is not used if empty
+            columns - requested columns
+            entries - number of entries in each file, filled when reading
+            offsets - index of the first entry of each file in the output columns, filled when reading
+            mapped - cached columns of each file, in the order of columns, or empty if a column of the file is not cached
+    */
+    public:
+        ColumnReader(const std::vector<std::string> &fileNames, const std::string &treeName, const Long64_t cacheSize = 100000000, const std::string &columnCacheDirectory = getColumnCacheDirectory()) : fileNames(fileNames), treeName(treeName), cacheSize(cacheSize), columnCacheDirectory(columnCacheDirectory) {};
+
+        template <typename T>
+        void addColumn(const std::string &branchName, std::vector<T> &values) {
+            /*
+                Description
+                    Requests the branch branchName to be read into values. The type T must match the type of the branch
+            */
+            columns.push_back(std::make_unique<Column<T>>(branchName, values));
+            return;
+        };
+
+        Long64_t read(const unsigned int nThreads = 0) {
+            /*
+                Description
+                    Checks the schema, sizes the output columns, and reads all files. Returns the total number of entries read
+
+                Arguments
+                    nThreads - maximum number of files read at the same time, 0 uses all available cores
+
+                Variables
+                    nFiles - number of files to read
+                    total - total number of entries over all files
+                    pool - thread pool used to read the files
+            */
+            const unsigned int nFiles = fileNames.size();
+            if (nFiles == 0)
+                return 0;
+
+            // Check the schema and count the entries once, before any data is read. The header of the cached columns holds both, so cached files are not opened
+            entries.assign(nFiles, 0);
+            offsets.assign(nFiles, 0);
+            mapped.clear();
+            mapped.resize(nFiles);
+            Long64_t total = 0;
+            for (unsigned int i = 0; i < nFiles; i++) {
+                mapped[i] = openCache(fileNames[i]);
+                entries[i] = mapped[i].empty() ? checkSchema(fileNames[i]) : mapped[i][0]->entries();
+                offsets[i] = total;
+                total += entries[i];
+            };
+
+            // Size the output columns once, so that each file fills its own slice
+            for (std::unique_ptr<ColumnBase> &column : columns)
+                column->resize(total);
+
+            // Read the files in parallel
+            if (!columnCacheDirectory.empty())
+                gSystem->mkdir(columnCacheDirectory.c_str(), kTRUE);
+            ROOT::EnableThreadSafety();
+            if (nFiles == 1 || nThreads == 1) {
+                for (unsigned int i = 0; i < nFiles; i++)
+                    readFile(i);
+            }
+            else {
+                ROOT::TThreadExecutor pool(std::min(nFiles, nThreads == 0 ? std::thread::hardware_concurrency() : nThreads));
+                pool.Foreach([this](unsigned int i) { readFile(i); }, ROOT::TSeqU(nFiles));
+            };
+            mapped.clear();
+            return total;
+        };
+
+        const std::vector<Long64_t> &fileEntries() const {
+            /*
+                Description
+                    Returns the number of entries read from each file, in the order of fileNames, filled by function "read"
+            */
+            return entries;
+        };
+
+        Long64_t readRanges(const std::vector<EntryRange> &ranges) {
+            /*
+                Description
+                    Checks the schema, sizes the output columns, and reads only the requested entry ranges of a single file, in order. Returns the total number of entries read
+                    The ranges are copied from the column cache if all the requested columns are cached. A partial read does not write the cache
+
+                Arguments
+                    ranges - entry ranges to read, e.g. as selected with EntryIndex
+
+                Variables
+                    nEntries - number of entries in the tree
+                    total - total number of entries over all ranges
+                    file - ROOT TFile interface
+                    tree - ROOT TTree interface
+                    branches - ROOT TBranch interfaces of the requested columns
+                    offset - index of the first entry of the range in the output columns
+                    cached - cached columns of the file, or empty if a column is not cached
+            */
+            if (fileNames.size() != 1)
+                Fatal("ColumnReader::readRanges", "Entry ranges can only be read from a single file.");
+
+            // Check the schema and the ranges
+            std::vector<std::unique_ptr<MappedColumn>> cached = openCache(fileNames[0]);
+            const Long64_t nEntries = cached.empty() ? checkSchema(fileNames[0]) : cached[0]->entries();
+            Long64_t total = 0;
+            for (const EntryRange &range : ranges) {
+                if (range.first < 0 || range.last > nEntries || range.first > range.last)
+                    Fatal("ColumnReader::readRanges", "Requested entry range is outside of the tree.");
+                total += range.last - range.first;
+            };
+            for (std::unique_ptr<ColumnBase> &column : columns)
+                column->resize(total);
+
+            // Copy the ranges from the cache if possible
+            Long64_t offset = 0;
+            if (!cached.empty()) {
+                for (const EntryRange &range : ranges) {
+                    for (unsigned int j = 0; j < columns.size(); j++)
+                        columns[j]->copy(cached[j]->data(), offset, range.first, range.last);
+                    offset += range.last - range.first;
+                };
+                return total;
+            };
+
+            // Read the ranges, limiting the cache to each range so that only the baskets of the range are read
+            std::unique_ptr<TFile> file(TFile::Open(fileNames[0].c_str()));
+            TTree *tree = (TTree*)file->Get(treeName.c_str());
+            std::vector<TBranch*> branches = setupCache(tree);
+            for (const EntryRange &range : ranges) {
+                tree->SetCacheEntryRange(range.first, range.last);
+                readEntries(tree, branches, offset, range.first, range.last);
+                offset += range.last - range.first;
+            };
+            file->Close();
+            return total;
+        };
+
+    private:
+        std::vector<std::unique_ptr<MappedColumn>> openCache(const std::string &fileName) const {
+            /*
+                Description
+                    Maps the cached columns of the file. Returns an empty vector if the cache is disabled or any requested column is not cached, or if the cached columns have different entry counts
+
+                Variables
+                    cache - column cache of the file
+                    cached - mapped cached columns
+            */
+            std::vector<std::unique_ptr<MappedColumn>> cached;
+            if (columnCacheDirectory.empty() || columns.empty())
+                return cached;
+            ColumnCache cache(columnCacheDirectory, fileName, treeName);
+            for (const std::unique_ptr<ColumnBase> &column : columns) {
+                cached.push_back(cache.open(column->branchName, column->type(), column->elementSize()));
+                if (!cached.back() || cached.back()->entries() != cached.front()->entries())
+                    return std::vector<std::unique_ptr<MappedColumn>>();
+            };
+            return cached;
+        };
+
+        Long64_t checkSchema(const std::string &fileName) {
+            /*
+                Description
+                    Checks that the file contains the tree and every requested branch with the requested type. Returns the number of entries in the tree
+
+                Variables
+                    file - ROOT TFile interface
+                    tree - ROOT TTree interface
+                    branch - ROOT TBranch interface
+                    branchClass - class of the branch, if it is not a fundamental type
+                    branchType - fundamental type of the branch
+                    nEntries - number of entries in the tree
+            */
+            std::unique_ptr<TFile> file(TFile::Open(fileName.c_str()));
+            if (!file || file->IsZombie())
+                Fatal("collectData", "Failed to open the file.");
+            TTree *tree = (TTree*)file->Get(treeName.c_str());
+            if (!tree)
+                Fatal("collectData", "Requested tree does not exist in the file.");
+            TBranch *branch = nullptr;
+            TClass *branchClass = nullptr;
+            EDataType branchType = kNoType_t;
+            for (std::unique_ptr<ColumnBase> &column : columns) {
+                branch = tree->GetBranch(column->branchName.c_str());
+                if (branch == nullptr)
+                    Fatal("collectData", ("Requested branch '" + column->branchName + "' does not exist in the file.").c_str());
+                branch->GetExpectedType(branchClass, branchType);
+                if (branchClass != nullptr || branchType != column->type())
+                    Fatal("collectData", ("Requested branch '" + column->branchName + "' does not have the requested type.").c_str());
+            };
+            const Long64_t nEntries = tree->GetEntries();
+            file->Close();
+            return nEntries;
+        };
+
+        std::vector<TBranch*> setupCache(TTree *tree) {
+            /*
+                Description
+                    Sets up the TTreeCache of the tree with only the requested branches. Returns the branches of the requested columns, in order
+            */
+            std::vector<TBranch*> branches;
+            tree->SetCacheSize(cacheSize);
+            for (std::unique_ptr<ColumnBase> &column : columns) {
+                branches.push_back(tree->GetBranch(column->branchName.c_str()));
+                tree->AddBranchToCache(branches.back(), kTRUE);
+            };
+            tree->StopCacheLearningPhase();
+            return branches;
+        };
+
+        void readEntries(TTree *tree, const std::vector<TBranch*> &branches, const Long64_t offset, const Long64_t first, const Long64_t last) {
+            /*
+                Description
+                    Reads the entries [first, last) into the output columns starting at offset. The entries are read cluster by cluster and branch by branch so every basket is decompressed once
+
+                Variables
+                    clusters - iterator over the clusters of the tree, starting at the cluster containing first
+                    start - first entry of the cluster, or first if the cluster starts before it
+                    end - one past the last entry of the cluster, or last if the cluster ends after it
+            */
+            TTree::TClusterIterator clusters = tree->GetClusterIterator(first);
+            Long64_t start = 0, end = 0;
+            while ((start = clusters()) < last) {
+                start = std::max(start, first);
+                end = std::min(clusters.GetNextEntry(), last);
+                for (unsigned int j = 0; j < columns.size(); j++)
+                    columns[j]->read(branches[j], offset + start - first, start, end);
+            };
+            return;
+        };
+
+        void readFile(const unsigned int i) {
+            /*
+                Description
+                    Reads the requested branches of one file into its slice of the output columns, from the column cache if possible, and writes the column cache otherwise
+
+                Variables
+                    file - ROOT TFile interface
+                    tree - ROOT TTree interface
+                    branches - ROOT TBranch interfaces of the requested columns
+                    cache - column cache of the file
+            */
+            if (!mapped[i].empty()) {
+                for (unsigned int j = 0; j < columns.size(); j++)
+                    columns[j]->copy(mapped[i][j]->data(), offsets[i], 0, entries[i]);
+                mapped[i].clear();
+                std::cout << "Loaded cached columns of file " << fileNames[i] << std::endl;
+                return;
+            };
+            std::cout << "Processing file " << fileNames[i] << std::endl;
+            std::unique_ptr<TFile> file(TFile::Open(fileNames[i].c_str()));
+            TTree *tree = (TTree*)file->Get(treeName.c_str());
+            std::vector<TBranch*> branches = setupCache(tree);
+            readEntries(tree, branches, offsets[i], 0, entries[i]);
+            file->Close();
+            if (!columnCacheDirectory.empty()) {
+                ColumnCache cache(columnCacheDirectory, fileNames[i], treeName);
+                for (std::unique_ptr<ColumnBase> &column : columns)
+                    cache.write(column->branchName, column->type(), column->elementSize(), column->slice(offsets[i]), entries[i]);
+            };
+            std::cout << "Finished processing file " << fileNames[i] << std::endl;
+            return;
+        };
+
+        const std::vector<std::string> fileNames;
+        const std::string treeName;
+        const Long64_t cacheSize;
+        const std::string columnCacheDirectory;
+        std::vector<std::unique_ptr<ColumnBase>> columns;
+        std::vector<Long64_t> entries, offsets;
+        std::vector<std::vector<std::unique_ptr<MappedColumn>>> mapped;
+};
+
+template <typename T>
+void scaleColumn(const std::vector<T> &input, std::vector<double> &output, const double factor) {
+    /*
+        Description
+            Post-pass converting a column to double while applying a scale factor, e.g. ADC clock ticks to ns. Written as a flat loop over contiguous data so that it is vectorized
+
+        Arguments
+            input - column to convert
+            output - converted column, resized to the size of input
+            factor - scale factor to apply
+    */
+    const size_t n = input.size();
+    output.resize(n);
+    const T *in = input.data();
+    double *out = output.data();
+    for (size_t i = 0; i < n; i++)
+        out[i] = in[i] * factor;
+    return;
+};
+
+template <typename T>
+void clampColumn(std::vector<T> &values, const T threshold, const T replacement) {
+    /*
+        Description
+            Post-pass replacing all values above threshold with replacement. Written as a flat loop over contiguous data so that it is vectorized
+
+        Arguments
+            values - column to clamp in place
+            threshold - maximum value to keep
+            replacement - value to replace values above threshold with
+    */
+    const size_t n = values.size();
+    T *v = values.data();
+    for (size_t i = 0; i < n; i++)
+        v[i] = v[i] > threshold ? replacement : v[i];
+    return;
+};
+
+#endif
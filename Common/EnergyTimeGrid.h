@@ -0,0 +1,194 @@
+// Binned (energy, time mod tMod) aggregation, filled in a single pass and queried for any energy and time window without revisiting the data
+// Usage example - see aggregateDataset in DataSummaries/SignalBackgroundRatio.C
+//   EnergyTimeGrid grid(2500, 0, 2.5, 500, 1695);
+//   for (Long64_t i = 0; i < entries; i++) grid.fill(energies[i], times[i]);
+//   grid.finalize();
+//   grid.count(0.312, 0.382, 300, 700);
+
+#ifndef ENERGYTIMEGRID_H
+#define ENERGYTIMEGRID_H
+
+#include <RtypesCore.h>
+#include <TError.h>
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <unordered_map>
+#include <vector>
+
+class EnergyTimeGrid {
+    /*
+        Description
+            2D histogram of entries in (energy, time mod tMod), with an underflow and overflow bin on each axis, and the summed energy of each energy bin. Once filled, finalize replaces the counts with their cumulative sums so that the number of entries in any window is found from four cells
+            Window edges are rounded to the nearest bin edge. A window edge beyond the axis range includes the underflow or overflow bin, so the entries and energy over all bins are exact
+            If tMod is 0 the time is ignored and the grid has a single time bin
+
+        Variables
+            nEnergyBins - number of energy bins, excluding the underflow and overflow bins
+            eMin - lower edge of the energy axis [MeV]
+            eMax - upper edge of the energy axis [MeV]
+            nTimeBins - number of time bins, excluding the underflow and overflow bins
+            tMod - modulus applied to the time [ns]
+            eWidth - energy bin width [MeV]
+            tWidth - time bin width [ns]
+            counts - number of entries in each (energy bin, time bin) cell, cumulative once finalized
+            energySums - summed energy in each energy bin, cumulative once finalized
+            finalized - true once finalize has been called
+    */
+    public:
+        EnergyTimeGrid(const int nEnergyBins, const double eMin, const double eMax, const int nTimeBins = 0, const double tMod = 0) : nEnergyBins(nEnergyBins), eMin(eMin), eMax(eMax), nTimeBins(tMod > 0 ? nTimeBins : 0), tMod(tMod) {
+            if (nEnergyBins < 1 || eMax <= eMin)
+                Fatal("EnergyTimeGrid", "The energy axis must have at least one bin and eMax > eMin");
+            if (tMod > 0 && nTimeBins < 1)
+                Fatal("EnergyTimeGrid", "The time axis must have at least one bin");
+            eWidth = (eMax - eMin) / nEnergyBins;
+            tWidth = tMod > 0 ? tMod / nTimeBins : 0;
+            counts.assign((Long64_t)(nEnergyBins + 2) * (this->nTimeBins + 2), 0);
+            energySums.assign(nEnergyBins + 2, 0);
+        };
+
+        double getTMod() const { return tMod; };
+
+        void fill(const double energy, const double time = 0) {
+            /*
+                Description
+                    Adds an entry. The time is taken modulo tMod, see SignalBackgroundRatio.C
+            */
+            if (finalized)
+                Fatal("EnergyTimeGrid::fill", "Cannot fill a finalized grid");
+            const int e = energyBin(energy), t = tMod > 0 ? timeBin(fmod(time, tMod)) : 0;
+            counts[(Long64_t)e * (nTimeBins + 2) + t]++;
+            energySums[e] += energy;
+            return;
+        };
+
+        void finalize() {
+            /*
+                Description
+                    Replaces the counts and energy sums with their cumulative sums, after which the grid can be queried but no longer filled
+            */
+            const int nT = nTimeBins + 2;
+            for (int e = 0; e < nEnergyBins + 2; e++) {
+                Long64_t *row = counts.data() + (Long64_t)e * nT;
+                for (int t = 1; t < nT; t++)
+                    row[t] += row[t - 1];
+                if (e > 0) {
+                    const Long64_t *previous = row - nT;
+                    for (int t = 0; t < nT; t++)
+                        row[t] += previous[t];
+                    energySums[e] += energySums[e - 1];
+                };
+            };
+            finalized = true;
+            return;
+        };
+
+        Long64_t count(const double eLow, const double eHigh, const double tLow = -std::numeric_limits<double>::infinity(), const double tHigh = std::numeric_limits<double>::infinity()) const {
+            /*
+                Description
+                    Returns the number of entries with energy in [eLow, eHigh] and time mod tMod in [tLow, tHigh], see the class description for the rounding of the edges
+            */
+            int e1 = 0, e2 = 0, t1 = 0, t2 = 0;
+            if (!energyRange(eLow, eHigh, e1, e2) || !timeRange(tLow, tHigh, t1, t2))
+                return 0;
+            return cell(e2, t2) - cell(e1 - 1, t2) - cell(e2, t1 - 1) + cell(e1 - 1, t1 - 1);
+        };
+
+        double energySum(const double eLow, const double eHigh) const {
+            /*
+                Description
+                    Returns the summed energy of the entries with energy in [eLow, eHigh], over all times
+            */
+            int e1 = 0, e2 = 0;
+            if (!energyRange(eLow, eHigh, e1, e2))
+                return 0;
+            checkFinalized();
+            return energySums[e2] - (e1 > 0 ? energySums[e1 - 1] : 0);
+        };
+
+        Long64_t entries() const { return count(-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()); };
+        double totalEnergy() const { return energySum(-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()); };
+
+    private:
+        int energyBin(const double energy) const {
+            if (energy < eMin)
+                return 0;
+            if (energy >= eMax)
+                return nEnergyBins + 1;
+            return std::min(nEnergyBins, (int)((energy - eMin) / eWidth) + 1);
+        };
+
+        int timeBin(const double time) const {
+            if (time < 0)
+                return 0;
+            return std::min(nTimeBins, (int)(time / tWidth) + 1);
+        };
+
+        bool energyRange(const double eLow, const double eHigh, int &e1, int &e2) const {
+            // Rounds [eLow, eHigh] to the bins between the nearest bin edges, including the underflow or overflow bin if the window extends beyond the axis
+            e1 = eLow <= eMin ? 0 : std::min(nEnergyBins + 1, (int)std::lround((eLow - eMin) / eWidth) + 1);
+            e2 = eHigh >= eMax ? nEnergyBins + 1 : std::max(0, (int)std::lround((eHigh - eMin) / eWidth));
+            return e1 <= e2;
+        };
+
+        bool timeRange(const double tLow, const double tHigh, int &t1, int &t2) const {
+            // As energyRange, for the time mod tMod. Without a time axis every time is accepted
+            if (tMod <= 0) {
+                t1 = t2 = 0;
+                return true;
+            };
+            t1 = tLow <= 0 ? (tLow < 0 ? 0 : 1) : std::min(nTimeBins + 1, (int)std::lround(tLow / tWidth) + 1);
+            t2 = tHigh >= tMod ? nTimeBins + 1 : std::max(0, (int)std::lround(tHigh / tWidth));
+            return t1 <= t2;
+        };
+
+        Long64_t cell(const int e, const int t) const {
+            checkFinalized();
+            if (e < 0 || t < 0)
+                return 0;
+            return counts[(Long64_t)e * (nTimeBins + 2) + t];
+        };
+
+        void checkFinalized() const {
+            if (!finalized)
+                Fatal("EnergyTimeGrid", "The grid must be finalized before it is queried");
+        };
+
+        const int nEnergyBins;
+        const double eMin, eMax;
+        const int nTimeBins;
+        const double tMod;
+        double eWidth = 0.0, tWidth = 0.0;
+        std::vector<Long64_t> counts;
+        std::vector<double> energySums;
+        bool finalized = false;
+};
+
+template <typename K>
+void aggregateGrids(const std::vector<K> &keys, const std::vector<double> &energies, const std::vector<double> &times, const EnergyTimeGrid &prototype, std::unordered_map<K, EnergyTimeGrid> &grids) {
+    /*
+        Description
+            Fills one grid per key, e.g. per PDG ID, in a single pass and finalizes them. New grids are copies of prototype. Consecutive entries often share a key, so the grid of the previous entry is reused without a hash lookup
+
+        Arguments
+            keys - key of each entry
+            energies - energy of each entry [MeV]
+            times - time of each entry [ns], or empty if prototype has no time axis
+            prototype - empty grid with the axes to use
+            grids - filled grids by key
+    */
+    const size_t n = keys.size();
+    if (energies.size() != n || (!times.empty() && times.size() != n))
+        Fatal("aggregateGrids", "The keys, energies, and times must have the same number of entries");
+    EnergyTimeGrid *grid = nullptr;
+    for (size_t i = 0; i < n; i++) {
+        if (grid == nullptr || keys[i] != keys[i - 1])
+            grid = &grids.emplace(keys[i], prototype).first->second;
+        grid->fill(energies[i], times.empty() ? 0 : times[i]);
+    };
+    for (std::pair<const K, EnergyTimeGrid> &entry : grids)
+        entry.second.finalize();
+    return;
+};
+
+#endif
@@ -0,0 +1,226 @@
+// Index of the entry ranges of each (event ID, waveform ID) group in a flat TTree, persisted as a sidecar file next to the ROOT file
+// Usage example - see plotMWDAnalysis in Plotting/plotMWDAnalysis.C
+//   EntryIndex index(fileName, treeName, "eventId", "waveformID");
+//   ColumnReader reader({fileName}, treeName);
+//   reader.addColumn("ADC", ADCs);
+//   reader.readRanges(index.select(eventID, waveformID));
+
+#ifndef ENTRYINDEX_H
+#define ENTRYINDEX_H
+
+#include "ColumnReader.h"
+#include <TSystem.h>
+#include <fstream>
+#include <map>
+#include <utility>
+
+class EntryIndex {
+    /*
+        Description
+            Maps each (event ID, waveform ID) pair to the entry ranges holding its data. The data of a group is normally a single contiguous range, but groups split over several ranges are supported. The index is built once by reading only the ID branches and is stored as
+                <fileName>.<treeName with '/' replaced by '_'>.index
+            It is reused while the size and modification time of the ROOT file are unchanged, and rebuilt otherwise. If no waveform ID branch is given, all waveform IDs are 0
+
+        Variables
+            fileName - ROOT file name as a relative path to cwd
+            treeName - name of the indexed tree
+            eventBranchName - name of the event ID branch
+            waveformBranchName - name of the waveform ID branch, or "" if the tree has no waveform ID
+            indexFileName - name of the sidecar file
+            fileSize - size of the ROOT file when the index was built, in bytes
+            fileModified - modification time of the ROOT file when the index was built
+            entries - number of entries in the tree
+            groups - entry ranges of each (event ID, waveform ID) pair, ordered by event ID then waveform ID
+    */
+    public:
+        typedef std::pair<unsigned int, unsigned int> Key;
+
+        EntryIndex(const std::string &fileName, const std::string &treeName, const std::string &eventBranchName = "eventId", const std::string &waveformBranchName = "") : fileName(fileName), treeName(treeName), eventBranchName(eventBranchName), waveformBranchName(waveformBranchName) {
+            std::string treeTag = treeName;
+            std::replace(treeTag.begin(), treeTag.end(), '/', '_');
+            indexFileName = fileName + "." + treeTag + ".index";
+
+            // Reuse the sidecar file if it is still valid, otherwise build and store the index
+            FileStat_t stat;
+            if (gSystem->GetPathInfo(fileName.c_str(), stat) != 0)
+                Fatal("EntryIndex", ("Failed to open the file " + fileName).c_str());
+            fileSize = stat.fSize;
+            fileModified = stat.fMtime;
+            if (!load()) {
+                build();
+                save();
+            };
+        };
+
+        const std::map<Key, std::vector<EntryRange>> &getGroups() const { return groups; };
+        Long64_t getEntries() const { return entries; };
+
+        std::vector<Key> keys(const unsigned int eventId = 0, const unsigned int waveformId = 0) const {
+            /*
+                Description
+                    Returns the keys of the groups matching eventId and waveformId, in order. An ID of 0 matches all IDs
+            */
+            std::vector<Key> matched;
+            for (const std::pair<const Key, std::vector<EntryRange>> &group : groups) {
+                if ((eventId == 0 || group.first.first == eventId) && (waveformId == 0 || group.first.second == waveformId))
+                    matched.push_back(group.first);
+            };
+            return matched;
+        };
+
+        std::vector<EntryRange> select(const unsigned int eventId = 0, const unsigned int waveformId = 0) const {
+            /*
+                Description
+                    Returns the entry ranges of all groups matching eventId and waveformId, in order. An ID of 0 matches all IDs
+            */
+            std::vector<EntryRange> ranges;
+            for (const Key &key : keys(eventId, waveformId)) {
+                const std::vector<EntryRange> &groupRanges = groups.at(key);
+                ranges.insert(ranges.end(), groupRanges.begin(), groupRanges.end());
+            };
+            return ranges;
+        };
+
+    private:
+        bool load() {
+            /*
+                Description
+                    Loads the sidecar file. Returns false if it does not exist or was built for a different file, tree, or set of branches
+
+                Variables
+                    indexFile - sidecar file stream
+                    header - format tag of the sidecar file
+                    version - format version of the sidecar file
+                    storedTreeName - tree name the sidecar file was built for
+                    storedEventBranchName - event ID branch name the sidecar file was built for
+                    storedWaveformBranchName - waveform ID branch name the sidecar file was built for, "-" if none
+                    storedSize - ROOT file size the sidecar file was built for
+                    storedModified - ROOT file modification time the sidecar file was built for
+                    nRanges - number of ranges in the sidecar file
+                    key - key of the range being read
+                    range - range being read
+            */
+            std::ifstream indexFile(indexFileName);
+            if (!indexFile.is_open())
+                return false;
+            std::string header = "", storedTreeName = "", storedEventBranchName = "", storedWaveformBranchName = "";
+            int version = 0;
+            Long64_t storedSize = 0, nRanges = 0;
+            Long_t storedModified = 0;
+            indexFile >> header >> version >> storedTreeName >> storedEventBranchName >> storedWaveformBranchName >> storedSize >> storedModified >> entries >> nRanges;
+            if (!indexFile || header != "EntryIndex" || version != 1 || storedTreeName != treeName || storedEventBranchName != eventBranchName || storedWaveformBranchName != (waveformBranchName.empty() ? "-" : waveformBranchName) || storedSize != fileSize || storedModified != fileModified)
+                return false;
+            Key key;
+            EntryRange range;
+            for (Long64_t i = 0; i < nRanges; i++) {
+                if (!(indexFile >> key.first >> key.second >> range.first >> range.last)) {
+                    groups.clear();
+                    return false;
+                };
+                groups[key].push_back(range);
+            };
+            std::cout << "Loaded entry index " << indexFileName << std::endl;
+            return true;
+        };
+
+        void build() {
+            /*
+                Description
+                    Builds the index by reading only the ID branches and run length encoding them into entry ranges
+
+                Variables
+                    eventIds - event IDs from file
+                    waveformIds - waveform IDs from file
+                    reader - columnar reader over the file
+                    first - first entry of the current run
+            */
+            std::cout << "Building entry index for " << fileName << std::endl;
+            std::vector<unsigned int> eventIds, waveformIds;
+            ColumnReader reader({fileName}, treeName);
+            reader.addColumn(eventBranchName, eventIds);
+            if (!waveformBranchName.empty())
+                reader.addColumn(waveformBranchName, waveformIds);
+            entries = reader.read();
+            if (waveformBranchName.empty())
+                waveformIds.assign(entries, 0);
+
+            // Run length encode the IDs
+            groups.clear();
+            Long64_t first = 0;
+            for (Long64_t i = 1; i <= entries; i++) {
+                if (i == entries || eventIds[i] != eventIds[first] || waveformIds[i] != waveformIds[first]) {
+                    groups[Key(eventIds[first], waveformIds[first])].push_back({first, i});
+                    first = i;
+                };
+            };
+            return;
+        };
+
+        void save() const {
+            /*
+                Description
+                    Stores the index in the sidecar file. If the sidecar file cannot be written, e.g. in a read only directory, the index is only kept in memory
+
+                Variables
+                    indexFile - sidecar file stream
+                    nRanges - number of ranges in the index
+            */
+            std::ofstream indexFile(indexFileName);
+            if (!indexFile.is_open()) {
+                std::cout << "Could not write entry index " << indexFileName << ", it will be rebuilt on the next run" << std::endl;
+                return;
+            };
+            Long64_t nRanges = 0;
+            for (const std::pair<const Key, std::vector<EntryRange>> &group : groups)
+                nRanges += group.second.size();
+            indexFile << "EntryIndex 1\n" << treeName << " " << eventBranchName << " " << (waveformBranchName.empty() ? "-" : waveformBranchName) << "\n" << fileSize << " " << fileModified << " " << entries << " " << nRanges << "\n";
+            for (const std::pair<const Key, std::vector<EntryRange>> &group : groups) {
+                for (const EntryRange &range : group.second)
+                    indexFile << group.first.first << " " << group.first.second << " " << range.first << " " << range.last << "\n";
+            };
+            std::cout << "Saved entry index " << indexFileName << std::endl;
+            return;
+        };
+
+        const std::string fileName, treeName, eventBranchName, waveformBranchName;
+        std::string indexFileName;
+        Long64_t fileSize = 0, entries = 0;
+        Long_t fileModified = 0;
+        std::map<Key, std::vector<EntryRange>> groups;
+};
+
+inline std::vector<EntryRange> compactRanges(const std::vector<EntryRange> &ranges, Long64_t &offset) {
+    /*
+        Description
+            Maps entry ranges of a tree to their position in columns read with ColumnReader::readRanges, where the selected ranges are stored back to back. Ranges must be passed in the order they were read
+
+        Arguments
+            ranges - entry ranges in the tree
+            offset - position of the first entry of ranges in the read columns, advanced past the last entry of ranges
+    */
+    std::vector<EntryRange> compacted;
+    for (const EntryRange &range : ranges) {
+        compacted.push_back({offset, offset + range.last - range.first});
+        offset = compacted.back().last;
+    };
+    return compacted;
+};
+
+template <typename T>
+void gatherRanges(const std::vector<T> &column, const std::vector<EntryRange> &ranges, std::vector<T> &selected) {
+    /*
+        Description
+            Copies the entries of the given ranges of a fully read column into selected, replacing its contents
+
+        Arguments
+            column - column read over all the entries of the tree
+            ranges - entry ranges to copy
+            selected - copied entries
+    */
+    selected.clear();
+    for (const EntryRange &range : ranges)
+        selected.insert(selected.end(), column.begin() + range.first, column.begin() + range.last);
+    return;
+};
+
+#endif
@@ -0,0 +1,82 @@
+// Detector models and file layout of the synthetic STM datasets written by Benchmark/generateSyntheticData.C
+// Usage example - see generateSyntheticData in Benchmark/generateSyntheticData.C
+//   const DetectorModel model = getDetectorModel("HPGe");
+//   const std::string fileName = syntheticFileName(outputDirectory, "ZSAnalysis");
+
+#ifndef SYNTHETICDATA_H
+#define SYNTHETICDATA_H
+
+#include <TError.h>
+#include <string>
+
+struct DetectorModel {
+    /*
+        Description
+            Response of an STM detector and the zero suppression and MWD parameters used to process it. Pulses are a step of height energy * gain decaying with tau, as in MWDLaBrTest.C, with the sign of the threshold
+            The kept windows of the zero suppression are longer than M + L so that the MWD is defined over each window
+
+        Variables
+            name - detector name, "HPGe" or "LaBr"
+            channel - detector name used by calibrateSTM.C, "H" or "L"
+            tau - decay time of the pulses [ns]
+            gain - pulse height per unit energy [ADC/MeV]
+            resolution - relative energy resolution, sigma / E
+            noise - electronic noise on every sample [ADC]
+            gradientStep - zero suppression gradient step, in ADC clock ticks
+            nAverage - number of zero suppression gradients averaged
+            nBefore - number of samples kept before a zero suppression trigger
+            nAfter - number of samples kept after a zero suppression trigger
+            threshold - zero suppression and MWD threshold, its sign sets the polarity of the pulses
+            M - MWD differentiation window length, in ADC clock ticks
+            L - MWD averaging window length, in ADC clock ticks
+    */
+    std::string name, channel;
+    double tau, gain, resolution, noise;
+    unsigned int gradientStep, nAverage, nBefore, nAfter;
+    double threshold;
+    unsigned int M, L;
+};
+
+inline DetectorModel getDetectorModel(const std::string &detector) {
+    /*
+        Description
+            Returns the model of the requested detector, either "HPGe" or "LaBr"
+    */
+    if (detector == "HPGe")
+        return {"HPGe", "H", 10000, 4000, 0.002, 3, 2, 4, 200, 400, -100, 200, 100};
+    if (detector == "LaBr")
+        return {"LaBr", "L", 35, 2000, 0.015, 3, 2, 4, 20, 60, -100, 30, 10};
+    Fatal("getDetectorModel", "detector has to be either 'HPGe' or 'LaBr'");
+    return {};
+};
+
+inline std::string syntheticFileName(const std::string &directory, const std::string &product) {
+    /*
+        Description
+            Returns the name of the file holding one data product of a synthetic dataset, see function "generateSyntheticData"
+    */
+    return directory + "/" + product + ".root";
+};
+
+inline std::string syntheticTreeName(const std::string &product, const std::string &detector) {
+    /*
+        Description
+            Returns the name of the tree holding one data product of a synthetic dataset, following the module labels of the production data
+    */
+    if (product == "ZSAnalysis" || product == "ZSWaveforms")
+        return "ZS" + detector + "/ttree";
+    if (product == "MWDAnalysis")
+        return "MWD" + detector + "/ttree";
+    if (product == "MWDSpectra")
+        return "MWDSpectra/ttree";
+    if (product == "Waveforms")
+        return "concatenateWaveforms" + detector + "/ttree";
+    if (product == "Stage1Signal" || product == "Stage1Background")
+        return "Stage1virtualdetector/ttree";
+    if (product == "Stage2Signal" || product == "Stage2Background")
+        return "Stage2" + detector + "/ttree";
+    Fatal("syntheticTreeName", "Unknown synthetic data product");
+    return "";
+};
+
+#endif
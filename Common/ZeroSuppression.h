@@ -0,0 +1,244 @@
+// Streaming replay of the STMZeroSuppression_module gradient, averaged gradient, and threshold logic, producing sparse waveforms
+// Usage example - see replayWaveforms in ZSAnalysis/ZSReplay.C
+//   ZeroSuppressor zs(gradientStep, nAverage, threshold, nBefore, nAfter);
+//   zs.push(ADCs.data(), ADCs.size(), output);
+//   zs.finish(output);
+
+#ifndef ZEROSUPPRESSION_H
+#define ZEROSUPPRESSION_H
+
+#include <RtypesCore.h>
+#include <TError.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+struct SparseWaveform {
+    /*
+        Description
+            Zero suppressed waveform, storing only the kept windows back to back
+
+        Variables
+            starts - index of the first sample of each window, relative to the first sample of the waveform, i.e. the time offset of the window in ADC clock ticks
+            offsets - index of the first sample of each window in ADCs, followed by the number of kept samples
+            ADCs - kept ADC values of all windows
+    */
+    std::vector<uint32_t> starts, offsets = {0};
+    std::vector<int16_t> ADCs;
+
+    size_t nWindows() const { return starts.size(); };
+
+    void clear() {
+        starts.clear();
+        offsets.assign(1, 0);
+        ADCs.clear();
+        return;
+    };
+
+    void expand(std::vector<int16_t> &dense, const uint32_t nSamples, const int16_t fill = 0) const {
+        /*
+            Description
+                Rebuilds the waveform of nSamples samples, with the removed samples set to fill
+        */
+        dense.assign(nSamples, fill);
+        for (size_t w = 0; w < nWindows(); w++) {
+            const uint32_t n = std::min(offsets[w + 1] - offsets[w], nSamples - std::min(starts[w], nSamples));
+            std::copy(ADCs.begin() + offsets[w], ADCs.begin() + offsets[w] + n, dense.begin() + starts[w]);
+        };
+        return;
+    };
+};
+
+class ZeroSuppressor {
+    /*
+        Description
+            Applies the zero suppression to a waveform supplied in pieces of any length, keeping only a bounded history. For each sample i
+                gradient[i] = ADC[i] - ADC[i - gradientStep]
+                averagedGradient[i] = mean of gradient[i - nAverage + 1] ... gradient[i]
+            A sample triggers if the averaged gradient is beyond threshold, below it for a negative threshold and above it otherwise, and the samples [i - nBefore, i + nAfter] are kept. Overlapping and touching windows are merged
+            Samples are processed in blocks of blockSize. The buffer holds the history needed by the kernels followed by the current block and the history is moved to the front after each block, so the buffer is a linearised ring buffer and every kernel is a flat loop over contiguous data that is vectorized
+
+        Variables
+            gradientStep - distance between the samples subtracted for the gradient, in ADC clock ticks
+            nAverage - number of gradients averaged
+            threshold - threshold on the averaged gradient, its sign sets the polarity of the pulses
+            nBefore - number of samples kept before a triggering sample
+            nAfter - number of samples kept after a triggering sample
+            pedestal - subtracted from the kept ADC values
+            blockSize - number of samples processed at a time
+            nHistory - number of samples kept from the previous block
+            thresholdSum - threshold applied to the sum of the nAverage gradients
+            buffer - history followed by the current block
+            gradients - gradients of the current block, starting nAverage - 1 samples before the block
+            sums - sums of nAverage gradients of the current block
+            triggers - 1 for samples of the current block beyond the threshold
+            base - index of the first sample of the current block in the waveform
+            open - true while a window is open
+            windowEnd - one past the last sample of the open window
+            cursor - next sample of the open window to copy to the output
+    */
+    public:
+        ZeroSuppressor(const unsigned int gradientStep, const unsigned int nAverage, const double threshold, const unsigned int nBefore, const unsigned int nAfter, const int16_t pedestal = 0, const unsigned int blockSize = 4096) : gradientStep(gradientStep), nAverage(nAverage), threshold(threshold), nBefore(nBefore), nAfter(nAfter), pedestal(pedestal), blockSize(blockSize) {
+            if (gradientStep == 0 || nAverage == 0 || blockSize == 0)
+                Fatal("ZeroSuppressor", "gradientStep, nAverage, and blockSize must be positive");
+            if (threshold == 0)
+                Fatal("ZeroSuppressor", "threshold must be non-zero");
+            nHistory = std::max(nBefore, gradientStep + nAverage - 1);
+            thresholdSum = threshold * nAverage;
+            buffer.assign(nHistory + blockSize, 0);
+            gradients.assign(blockSize + nAverage - 1, 0);
+            sums.assign(blockSize, 0);
+            triggers.assign(blockSize, 0);
+        };
+
+        void push(const int16_t *samples, const size_t n, SparseWaveform &output) {
+            /*
+                Description
+                    Appends n samples to the current waveform. Kept samples are written to output as soon as they are known to be kept
+            */
+            size_t done = 0, m = 0;
+            while (done < n) {
+                m = std::min<size_t>(blockSize, n - done);
+                std::copy(samples + done, samples + done + m, buffer.begin() + nHistory);
+                processBlock(m, output);
+                done += m;
+            };
+            return;
+        };
+
+        void finish(SparseWaveform &output) {
+            /*
+                Description
+                    Ends the current waveform, closing the open window at the last sample, and resets the state for the next waveform
+            */
+            if (open) {
+                windowEnd = std::min(windowEnd, base);
+                closeWindow(output);
+            };
+            std::fill(buffer.begin(), buffer.end(), 0);
+            base = 0;
+            return;
+        };
+
+    private:
+        void processBlock(const unsigned int n, SparseWaveform &output) {
+            /*
+                Description
+                    Runs the kernels over the n samples of the current block, handles the triggers, copies the kept samples, and moves the history to the front of the buffer
+
+                Variables
+                    x - first sample of the block in the buffer, valid down to x[-nHistory]
+                    nGradients - number of gradients needed for the block
+                    firstValid - first sample of the block with a full averaged gradient
+                    it - iterator over the triggers
+            */
+            const int16_t *x = buffer.data() + nHistory;
+            const unsigned int nGradients = n + nAverage - 1;
+            int32_t *g = gradients.data(), *s = sums.data();
+            uint8_t *t = triggers.data();
+
+            // Gradient, starting nAverage - 1 samples before the block so that every sample of the block has a full average
+            const int16_t *xg = x - (nAverage - 1), *xs = xg - gradientStep;
+            for (unsigned int i = 0; i < nGradients; i++)
+                g[i] = (int32_t)xg[i] - (int32_t)xs[i];
+
+            // Averaged gradient, kept as the sum of nAverage gradients
+            for (unsigned int i = 0; i < n; i++)
+                s[i] = g[i];
+            for (unsigned int k = 1; k < nAverage; k++) {
+                const int32_t *gk = g + k;
+                for (unsigned int i = 0; i < n; i++)
+                    s[i] += gk[i];
+            };
+
+            // Threshold
+            if (thresholdSum < 0) {
+                for (unsigned int i = 0; i < n; i++)
+                    t[i] = s[i] < thresholdSum;
+            }
+            else {
+                for (unsigned int i = 0; i < n; i++)
+                    t[i] = s[i] > thresholdSum;
+            };
+            const Long64_t firstValid = std::max<Long64_t>(0, (Long64_t)(gradientStep + nAverage - 1) - base);
+            std::fill(t, t + std::min<Long64_t>(firstValid, n), 0);
+
+            // Triggers are sparse, so find them with a byte search
+            uint8_t *it = t;
+            while ((it = std::find(it, t + n, 1)) != t + n) {
+                trigger(base + (it - t), output);
+                it++;
+            };
+
+            // Copy the kept samples of the block and close the window if no later trigger can extend it
+            if (open) {
+                const Long64_t last = std::min(windowEnd, base + n);
+                append(cursor, last, output);
+                cursor = last;
+                if (windowEnd + (Long64_t)nBefore < base + n)
+                    closeWindow(output);
+            };
+
+            // Move the history to the front of the buffer
+            std::copy(buffer.begin() + n, buffer.begin() + n + nHistory, buffer.begin());
+            base += n;
+            return;
+        };
+
+        void trigger(const Long64_t i, SparseWaveform &output) {
+            /*
+                Description
+                    Extends the open window to keep sample i, or closes it and opens a new window if they do not touch
+            */
+            const Long64_t start = std::max<Long64_t>(0, i - nBefore);
+            if (open && start <= windowEnd) {
+                windowEnd = std::max(windowEnd, i + nAfter + 1);
+                return;
+            };
+            if (open)
+                closeWindow(output);
+            output.starts.push_back(start);
+            cursor = start;
+            windowEnd = i + nAfter + 1;
+            open = true;
+            return;
+        };
+
+        void append(const Long64_t first, const Long64_t last, SparseWaveform &output) {
+            /*
+                Description
+                    Copies the samples [first, last) of the waveform to the output, subtracting the pedestal. The samples must be in the buffer
+            */
+            if (last <= first)
+                return;
+            const size_t size = output.ADCs.size();
+            output.ADCs.resize(size + (last - first));
+            const int16_t *in = buffer.data() + nHistory + (first - base);
+            int16_t *out = output.ADCs.data() + size;
+            for (Long64_t i = 0; i < last - first; i++)
+                out[i] = in[i] - pedestal;
+            return;
+        };
+
+        void closeWindow(SparseWaveform &output) {
+            append(cursor, windowEnd, output);
+            output.offsets.push_back(output.ADCs.size());
+            open = false;
+            return;
+        };
+
+        const unsigned int gradientStep, nAverage;
+        const double threshold;
+        const unsigned int nBefore, nAfter;
+        const int16_t pedestal;
+        const unsigned int blockSize;
+        unsigned int nHistory = 0;
+        double thresholdSum = 0.0;
+        std::vector<int16_t> buffer;
+        std::vector<int32_t> gradients, sums;
+        std::vector<uint8_t> triggers;
+        Long64_t base = 0, windowEnd = 0, cursor = 0;
+        bool open = false;
+};
+
+#endif